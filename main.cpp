@@ -1,19 +1,28 @@
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <iterator>
+#include <map>
 #include <memory>
 #include <sstream>
 #include <string>
 #include <system_error>
+#include <thread>
 #include <vector>
 #include <utility>
 
 #include "llvm/ADT/Optional.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Config/llvm-config.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/InlineAsm.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LegacyPassManager.h"
@@ -27,6 +36,7 @@
 #include "llvm/Support/Error.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Host.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/Program.h"
 #include "llvm/Support/raw_ostream.h"
@@ -37,6 +47,9 @@
 #include "llvm/Transforms/InstCombine/InstCombine.h"
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Transforms/Scalar/GVN.h"
+#include "llvm/Transforms/Utils.h"
+#include "llvm/Transforms/Utils/SplitModule.h"
+#include "llvm/Transforms/Vectorize.h"
 
 
 std::ostream & operator<<(std::ostream & os, const std::exception & e) {
@@ -88,14 +101,71 @@ public:
 char ParseError::ID = 0;
 
 
+enum class Syscall: uint8_t {
+    read,
+    write,
+    mmap,
+    exit
+};
+
+struct SyscallABI {
+    const char * instruction;
+    const char * numberRegister;
+    const char * resultRegister;
+    std::vector<const char *> argumentRegisters;
+    const char * clobbers;
+    uint64_t numbers[4];
+    uint64_t mapAnonymousFlag;
+
+    uint64_t getNumber(Syscall syscall) const { return numbers[static_cast<uint8_t>(syscall)]; }
+};
+
+static llvm::Optional<SyscallABI> getSyscallABI(const llvm::Triple & triple) {
+    // Only Linux keeps its syscall numbers stable and runs static executables.
+    if (!triple.isOSLinux()) return llvm::None;
+
+    switch (triple.getArch()) {
+        case llvm::Triple::x86_64:
+            return SyscallABI{"syscall", "rax", "rax", {"rdi", "rsi", "rdx", "r10", "r8", "r9"}, "~{rcx},~{r11},~{memory}",
+                              {0, 1, 9, 60}, 0x20};
+        case llvm::Triple::aarch64:
+            return SyscallABI{"svc #0", "x8", "x0", {"x0", "x1", "x2", "x3", "x4", "x5"}, "~{memory}",
+                              {63, 64, 222, 93}, 0x20};
+        default:
+            return llvm::None;
+    }
+}
+
+
+struct TapeRange {
+    bool isBounded;
+    bool hasStaticOffsets;
+    int64_t minimumOffset;
+    int64_t maximumOffset;
+    int64_t minimumMovement;
+    int64_t maximumMovement;
+};
+
+
+const uint64_t staticTapeLength = 65536;
+const uint64_t outputBufferLength = 4096;
+const uint64_t inputBufferLength = 4096;
+
+// The loop passes and keeping cells in registers get superlinear in the size of a function, so functions
+// with more instructions than this are optimized for size and only run through the scalar passes.
+const size_t loopOptimizationLengthLimit = 5000;
+
+
 std::vector<Instruction> instructions;
 std::vector<Instruction>::iterator currentInstruction;
+std::vector<size_t> loopLengths;
+std::vector<TapeRange> loopRanges;
+TapeRange programRange;
 
 
 llvm::LLVMContext context;
 llvm::IRBuilder<> builder(context);
 std::unique_ptr<llvm::Module> module;
-std::unique_ptr<llvm::legacy::FunctionPassManager> passManager;
 
 llvm::GlobalVariable * emptyString;
 llvm::GlobalVariable * moveLeftErrorString;
@@ -105,6 +175,15 @@ llvm::StructType * fileStruct;
 llvm::GlobalVariable * stdinP;
 llvm::GlobalVariable * stderrP;
 
+llvm::Optional<SyscallABI> syscallABI;
+
+llvm::GlobalVariable * staticTape;
+llvm::GlobalVariable * outputBuffer;
+llvm::GlobalVariable * outputBufferPosition;
+llvm::GlobalVariable * inputBuffer;
+llvm::GlobalVariable * inputBufferPosition;
+llvm::GlobalVariable * inputBufferEnd;
+
 llvm::Function * mallocFunction;
 llvm::Function * reallocFunction;
 llvm::Function * freeFunction;
@@ -113,19 +192,34 @@ llvm::Function * getlineFunction;
 llvm::Function * fputsFunction;
 llvm::Function * putcharFunction;
 
+llvm::Function * growCellsFunction;
+llvm::Function * reserveCellsFunction;
+llvm::Function * flushOutputFunction;
+llvm::Function * startFunction;
+
 llvm::Function * moveRightFunction;
 llvm::Function * inputFunction;
+llvm::Function * outputFunction;
 llvm::Function * mainFunction;
+llvm::Function * currentFunction;
 
 llvm::BasicBlock * errorBlock;
 
+bool checkLowerBound = true;
+bool checkUpperBound = true;
+bool canVersionLoops = true;
+
+llvm::Value * loopCells = nullptr;
+std::map<int64_t, llvm::AllocaInst *> loopCellVariables;
+int64_t loopCellOffset;
 
-llvm::AllocaInst * cellsAlloca;
-llvm::AllocaInst * cellsLengthAlloca;
-llvm::AllocaInst * currentCellAlloca;
-llvm::AllocaInst * currentLineAlloca;
-llvm::AllocaInst * lengthAlloca;
-llvm::AllocaInst * currentPositionAlloca;
+
+llvm::Value * cellsVariable;
+llvm::Value * cellsLengthVariable;
+llvm::Value * currentCellVariable;
+llvm::Value * currentLineVariable;
+llvm::Value * lengthVariable;
+llvm::Value * currentPositionVariable;
 
 
 llvm::cl::OptionCategory compilerCategory("Compiler Options", "Options for controlling the compilation process.");
@@ -141,6 +235,32 @@ llvm::cl::alias outputFileNameAlias("output-file",
                                     llvm::cl::aliasopt(outputFileNameOption),
                                     llvm::cl::cat(compilerCategory));
 
+llvm::cl::opt<bool> freestandingOption("freestanding",
+                                        llvm::cl::desc("Emit a self-contained runtime that uses raw syscalls "
+                                                       "instead of linking against the C library"),
+                                        llvm::cl::cat(compilerCategory));
+
+llvm::cl::opt<unsigned> partitionSizeOption("partition-size",
+                                            llvm::cl::desc("Outline loops and chunks of more than <n> instructions into "
+                                                           "separate functions (0 disables partitioning)"),
+                                            llvm::cl::value_desc("n"),
+                                            llvm::cl::init(5000),
+                                            llvm::cl::cat(compilerCategory));
+
+llvm::cl::opt<unsigned> threadCountOption("j",
+                                          llvm::cl::desc("Use <n> threads for optimization and code generation "
+                                                         "(defaults to the number of available cores)"),
+                                          llvm::cl::value_desc("n"),
+                                          llvm::cl::init(0),
+                                          llvm::cl::Prefix,
+                                          llvm::cl::cat(compilerCategory));
+
+llvm::cl::alias threadCountAlias("jobs",
+                                 llvm::cl::desc("Alias for -j"),
+                                 llvm::cl::value_desc("n"),
+                                 llvm::cl::aliasopt(threadCountOption),
+                                 llvm::cl::cat(compilerCategory));
+
 llvm::cl::opt<std::string> inputFileNameOption(llvm::cl::Positional,
                                                llvm::cl::desc("<input file>"),
                                                llvm::cl::Required,
@@ -177,9 +297,34 @@ static void createSTDIO() {
     module->getGlobalList().push_back(stderrP);
 }
 
-static llvm::Function * createFunction(llvm::Type * returnType, const std::vector<llvm::Type *> & params, bool isVarArg, llvm::StringRef name) {
+static llvm::Function * createFunction(llvm::Type * returnType, const std::vector<llvm::Type *> & params, bool isVarArg, llvm::StringRef name,
+                                       llvm::GlobalValue::LinkageTypes linkage = llvm::GlobalValue::ExternalLinkage) {
     llvm::FunctionType * type = llvm::FunctionType::get(returnType, params, isVarArg);
-    return llvm::Function::Create(type, llvm::Function::ExternalLinkage, name, module.get());
+    return llvm::Function::Create(type, linkage, name, module.get());
+}
+
+static llvm::Value * createSyscall(Syscall syscall, const std::vector<llvm::Value *> & args) {
+    llvm::Type * i64 = llvm::Type::getInt64Ty(context);
+
+    std::string constraints = std::string("={") + syscallABI->resultRegister + "},{" + syscallABI->numberRegister + "}";
+    std::vector<llvm::Type *> argTypes = {i64};
+    std::vector<llvm::Value *> argValues = {builder.getInt64(syscallABI->getNumber(syscall))};
+
+    for (size_t i = 0; i < args.size(); ++i) {
+        constraints += std::string(",{") + syscallABI->argumentRegisters[i] + "}";
+        argTypes.push_back(i64);
+
+        llvm::Value * arg = args[i];
+        if (arg->getType()->isPointerTy()) arg = builder.CreatePtrToInt(arg, i64);
+        argValues.push_back(arg);
+    }
+
+    constraints += std::string(",") + syscallABI->clobbers;
+
+    llvm::FunctionType * type = llvm::FunctionType::get(i64, argTypes, false);
+    llvm::InlineAsm * inlineAsm = llvm::InlineAsm::get(type, syscallABI->instruction, constraints, true);
+
+    return builder.CreateCall(type, inlineAsm, argValues);
 }
 
 static void createMoveRightFunction() {
@@ -227,9 +372,9 @@ static void createMoveRightFunction() {
     builder.CreateCondBr(resizeCells, thenBlock, mergeBlock);
     builder.SetInsertPoint(thenBlock);
 
-    cellsLength = builder.CreateLoad(i64, cellsLengthPointer);
+    llvm::Value * previousCellsLength = builder.CreateLoad(i64, cellsLengthPointer);
 
-    cellsLength = builder.CreateMul(builder.getInt64(2), cellsLength, "doubledCellsLength");
+    cellsLength = builder.CreateMul(builder.getInt64(2), previousCellsLength, "doubledCellsLength");
 
     builder.CreateStore(cellsLength, cellsLengthPointer);
 
@@ -238,7 +383,11 @@ static void createMoveRightFunction() {
 
     cellsLength = builder.CreateLoad(i64, cellsLengthPointer);
 
-    cells = builder.CreateCall(reallocFunction, {cells, cellsLength}, "reallocatedCells");
+    if (freestandingOption) {
+        cells = builder.CreateCall(growCellsFunction, {cells, previousCellsLength, cellsLength}, "reallocatedCells");
+    } else {
+        cells = builder.CreateCall(reallocFunction, {cells, cellsLength}, "reallocatedCells");
+    }
 
     builder.CreateStore(cells, cellsPointer);
 
@@ -249,8 +398,69 @@ static void createMoveRightFunction() {
     builder.CreateRetVoid();
 
     llvm::verifyFunction(*moveRightFunction, &llvm::errs());
+}
+
+static void createReserveCellsFunction() {
+    llvm::Type * i8Ptr = llvm::Type::getInt8PtrTy(context);
+    llvm::Type * i8PtrPtr = i8Ptr->getPointerTo();
+    llvm::Type * i64 = llvm::Type::getInt64Ty(context);
+    llvm::Type * i64Ptr = llvm::Type::getInt64PtrTy(context);
+
+    reserveCellsFunction = createFunction(llvm::Type::getVoidTy(context), {i8PtrPtr, i64Ptr, i64}, false, "reserveCells");
+    llvm::BasicBlock * entryBlock = llvm::BasicBlock::Create(context, "entry", reserveCellsFunction);
+    builder.SetInsertPoint(entryBlock);
+
+    auto args = reserveCellsFunction->args();
+    llvm::Argument * cellsPointerArgument = args.begin();
+    llvm::Argument * cellsLengthPointerArgument = args.begin() + 1;
+    llvm::Argument * requiredLengthArgument = args.begin() + 2;
+
+    cellsPointerArgument->setName("cells");
+    cellsLengthPointerArgument->setName("cellsLength");
+    requiredLengthArgument->setName("requiredLength");
+
+    llvm::Value * cellsLength = builder.CreateLoad(i64, cellsLengthPointerArgument);
+
+    llvm::Value * resizeCells = builder.CreateICmpULT(cellsLength, requiredLengthArgument, "resizeCells");
+
+    llvm::BasicBlock * doubleBlock = llvm::BasicBlock::Create(context, "double", reserveCellsFunction);
+    llvm::BasicBlock * resizeBlock = llvm::BasicBlock::Create(context, "resize");
+    llvm::BasicBlock * mergeBlock = llvm::BasicBlock::Create(context, "merge");
+
+    builder.CreateCondBr(resizeCells, doubleBlock, mergeBlock);
+    builder.SetInsertPoint(doubleBlock);
+
+    llvm::PHINode * newCellsLength = builder.CreatePHI(i64, 2, "newCellsLength");
+    newCellsLength->addIncoming(cellsLength, entryBlock);
+
+    llvm::Value * doubledCellsLength = builder.CreateMul(builder.getInt64(2), newCellsLength, "doubledCellsLength");
+    newCellsLength->addIncoming(doubledCellsLength, doubleBlock);
+
+    llvm::Value * continueDoubling = builder.CreateICmpULT(doubledCellsLength, requiredLengthArgument, "continueDoubling");
+
+    builder.CreateCondBr(continueDoubling, doubleBlock, resizeBlock);
+    reserveCellsFunction->getBasicBlockList().push_back(resizeBlock);
+    builder.SetInsertPoint(resizeBlock);
+
+    builder.CreateStore(doubledCellsLength, cellsLengthPointerArgument);
 
-    passManager->run(*moveRightFunction);
+    llvm::Value * cells = builder.CreateLoad(i8Ptr, cellsPointerArgument);
+
+    if (freestandingOption) {
+        cells = builder.CreateCall(growCellsFunction, {cells, cellsLength, doubledCellsLength}, "reallocatedCells");
+    } else {
+        cells = builder.CreateCall(reallocFunction, {cells, doubledCellsLength}, "reallocatedCells");
+    }
+
+    builder.CreateStore(cells, cellsPointerArgument);
+
+    builder.CreateBr(mergeBlock);
+    reserveCellsFunction->getBasicBlockList().push_back(mergeBlock);
+    builder.SetInsertPoint(mergeBlock);
+
+    builder.CreateRetVoid();
+
+    llvm::verifyFunction(*reserveCellsFunction, &llvm::errs());
 }
 
 static void createInputFunction() {
@@ -333,12 +543,239 @@ static void createInputFunction() {
     builder.CreateRetVoid();
 
     llvm::verifyFunction(*inputFunction, &llvm::errs());
+}
+
+
+static void createFreestandingInputFunction() {
+    llvm::Type * i8 = llvm::Type::getInt8Ty(context);
+    llvm::Type * i8Ptr = llvm::Type::getInt8PtrTy(context);
+    llvm::Type * i64 = llvm::Type::getInt64Ty(context);
+
+    inputFunction = createFunction(llvm::Type::getVoidTy(context), {i8Ptr, i64}, false, "input", llvm::GlobalValue::InternalLinkage);
+    llvm::BasicBlock * entryBlock = llvm::BasicBlock::Create(context, "entry", inputFunction);
+    builder.SetInsertPoint(entryBlock);
+
+    auto args = inputFunction->args();
+    llvm::Argument * cellsArgument = args.begin();
+    llvm::Argument * currentCellArgument = args.begin() + 1;
+
+    cellsArgument->setName("cells");
+    currentCellArgument->setName("currentCell");
+
+    llvm::Value * cellsGEP = builder.CreateGEP(i8, cellsArgument, currentCellArgument);
+
+    llvm::Value * position = builder.CreateLoad(i64, inputBufferPosition);
+    llvm::Value * bufferEnd = builder.CreateLoad(i64, inputBufferEnd);
+
+    llvm::Value * bufferEmpty = builder.CreateICmpEQ(position, bufferEnd, "bufferEmpty");
+
+    llvm::BasicBlock * refillBlock = llvm::BasicBlock::Create(context, "refill", inputFunction);
+    llvm::BasicBlock * endOfInputBlock = llvm::BasicBlock::Create(context, "endOfInput");
+    llvm::BasicBlock * readBlock = llvm::BasicBlock::Create(context, "read");
+
+    builder.CreateCondBr(bufferEmpty, refillBlock, readBlock);
+    builder.SetInsertPoint(refillBlock);
+
+    // Pending output is flushed first, so that prompts are visible before the program blocks on input.
+    builder.CreateCall(flushOutputFunction);
+
+    llvm::Value * buffer = builder.CreateConstInBoundsGEP2_64(inputBuffer->getValueType(), inputBuffer, 0, 0);
+    llvm::Value * readLength = createSyscall(Syscall::read, {builder.getInt64(0), buffer, builder.getInt64(inputBufferLength)});
+
+    builder.CreateStore(builder.getInt64(0), inputBufferPosition);
+
+    llvm::Value * endOfInput = builder.CreateICmpSLE(readLength, builder.getInt64(0), "endOfInput");
+    builder.CreateStore(builder.CreateSelect(endOfInput, builder.getInt64(0), readLength), inputBufferEnd);
+
+    builder.CreateCondBr(endOfInput, endOfInputBlock, readBlock);
+    inputFunction->getBasicBlockList().push_back(endOfInputBlock);
+    builder.SetInsertPoint(endOfInputBlock);
+
+    // A cell gets the value 0 if the end of the input has been reached.
+    builder.CreateStore(builder.getInt8(0), cellsGEP);
+
+    builder.CreateRetVoid();
+
+    inputFunction->getBasicBlockList().push_back(readBlock);
+    builder.SetInsertPoint(readBlock);
+
+    position = builder.CreateLoad(i64, inputBufferPosition);
+
+    llvm::Value * bufferGEP = builder.CreateInBoundsGEP(inputBuffer->getValueType(), inputBuffer, {builder.getInt64(0), position});
+    builder.CreateStore(builder.CreateLoad(i8, bufferGEP), cellsGEP);
+
+    position = builder.CreateAdd(position, builder.getInt64(1), "incrementedPosition");
+    builder.CreateStore(position, inputBufferPosition);
+
+    builder.CreateRetVoid();
+
+    llvm::verifyFunction(*inputFunction, &llvm::errs());
+}
+
+static void createGrowCellsFunction() {
+    llvm::Type * i8 = llvm::Type::getInt8Ty(context);
+    llvm::Type * i8Ptr = llvm::Type::getInt8PtrTy(context);
+    llvm::Type * i64 = llvm::Type::getInt64Ty(context);
+
+    growCellsFunction = createFunction(i8Ptr, {i8Ptr, i64, i64}, false, "growCells", llvm::GlobalValue::InternalLinkage);
+    llvm::BasicBlock * entryBlock = llvm::BasicBlock::Create(context, "entry", growCellsFunction);
+    builder.SetInsertPoint(entryBlock);
+
+    auto args = growCellsFunction->args();
+    llvm::Argument * cellsArgument = args.begin();
+    llvm::Argument * cellsLengthArgument = args.begin() + 1;
+    llvm::Argument * newCellsLengthArgument = args.begin() + 2;
+
+    cellsArgument->setName("cells");
+    cellsLengthArgument->setName("cellsLength");
+    newCellsLengthArgument->setName("newCellsLength");
+
+    // Anonymous mappings are zero-filled, so only the old cells have to be copied over.
+    llvm::Value * newCells = createSyscall(Syscall::mmap, {
+        builder.getInt64(0),
+        newCellsLengthArgument,
+        builder.getInt64(0x1 | 0x2),
+        builder.getInt64(0x2 | syscallABI->mapAnonymousFlag),
+        builder.getInt64(-1),
+        builder.getInt64(0)
+    });
+    newCells = builder.CreateIntToPtr(newCells, i8Ptr, "newCells");
+
+    llvm::BasicBlock * copyBlock = llvm::BasicBlock::Create(context, "copy", growCellsFunction);
+    llvm::BasicBlock * mergeBlock = llvm::BasicBlock::Create(context, "merge");
+
+    builder.CreateBr(copyBlock);
+    builder.SetInsertPoint(copyBlock);
+
+    llvm::PHINode * index = builder.CreatePHI(i64, 2, "index");
+    index->addIncoming(builder.getInt64(0), entryBlock);
+
+    llvm::Value * cellValue = builder.CreateLoad(i8, builder.CreateGEP(i8, cellsArgument, index));
+    builder.CreateStore(cellValue, builder.CreateGEP(i8, newCells, index));
+
+    llvm::Value * nextIndex = builder.CreateAdd(index, builder.getInt64(1), "nextIndex");
+    index->addIncoming(nextIndex, copyBlock);
+
+    llvm::Value * continueCopy = builder.CreateICmpULT(nextIndex, cellsLengthArgument, "continueCopy");
+
+    builder.CreateCondBr(continueCopy, copyBlock, mergeBlock);
+    growCellsFunction->getBasicBlockList().push_back(mergeBlock);
+    builder.SetInsertPoint(mergeBlock);
+
+    builder.CreateRet(newCells);
+
+    llvm::verifyFunction(*growCellsFunction, &llvm::errs());
+}
+
+static void createFlushOutputFunction() {
+    llvm::Type * i64 = llvm::Type::getInt64Ty(context);
+
+    flushOutputFunction = createFunction(llvm::Type::getVoidTy(context), {}, false, "flushOutput", llvm::GlobalValue::InternalLinkage);
+    llvm::BasicBlock * entryBlock = llvm::BasicBlock::Create(context, "entry", flushOutputFunction);
+    builder.SetInsertPoint(entryBlock);
+
+    llvm::Value * position = builder.CreateLoad(i64, outputBufferPosition);
+
+    llvm::Value * shouldFlush = builder.CreateICmpNE(position, builder.getInt64(0), "shouldFlush");
+
+    llvm::BasicBlock * thenBlock = llvm::BasicBlock::Create(context, "then", flushOutputFunction);
+    llvm::BasicBlock * mergeBlock = llvm::BasicBlock::Create(context, "merge");
+
+    builder.CreateCondBr(shouldFlush, thenBlock, mergeBlock);
+    builder.SetInsertPoint(thenBlock);
+
+    llvm::Value * buffer = builder.CreateConstInBoundsGEP2_64(outputBuffer->getValueType(), outputBuffer, 0, 0);
+
+    createSyscall(Syscall::write, {builder.getInt64(1), buffer, position});
+
+    builder.CreateStore(builder.getInt64(0), outputBufferPosition);
+
+    builder.CreateBr(mergeBlock);
+    flushOutputFunction->getBasicBlockList().push_back(mergeBlock);
+    builder.SetInsertPoint(mergeBlock);
+
+    builder.CreateRetVoid();
+
+    llvm::verifyFunction(*flushOutputFunction, &llvm::errs());
+}
+
+static void createFreestandingOutputFunction() {
+    llvm::Type * i8 = llvm::Type::getInt8Ty(context);
+    llvm::Type * i32 = llvm::Type::getInt32Ty(context);
+    llvm::Type * i64 = llvm::Type::getInt64Ty(context);
+
+    outputFunction = createFunction(i32, {i32}, false, "output", llvm::GlobalValue::InternalLinkage);
+    llvm::BasicBlock * entryBlock = llvm::BasicBlock::Create(context, "entry", outputFunction);
+    builder.SetInsertPoint(entryBlock);
+
+    llvm::Argument * characterArgument = outputFunction->args().begin();
+    characterArgument->setName("character");
+
+    llvm::Value * position = builder.CreateLoad(i64, outputBufferPosition);
+
+    llvm::Value * bufferGEP = builder.CreateInBoundsGEP(outputBuffer->getValueType(), outputBuffer, {builder.getInt64(0), position});
+    builder.CreateStore(builder.CreateTrunc(characterArgument, i8), bufferGEP);
+
+    position = builder.CreateAdd(position, builder.getInt64(1), "incrementedPosition");
+    builder.CreateStore(position, outputBufferPosition);
+
+    llvm::Value * bufferFull = builder.CreateICmpEQ(position, builder.getInt64(outputBufferLength), "bufferFull");
+
+    llvm::BasicBlock * thenBlock = llvm::BasicBlock::Create(context, "then", outputFunction);
+    llvm::BasicBlock * mergeBlock = llvm::BasicBlock::Create(context, "merge");
+
+    builder.CreateCondBr(bufferFull, thenBlock, mergeBlock);
+    builder.SetInsertPoint(thenBlock);
+
+    builder.CreateCall(flushOutputFunction);
+
+    builder.CreateBr(mergeBlock);
+    outputFunction->getBasicBlockList().push_back(mergeBlock);
+    builder.SetInsertPoint(mergeBlock);
+
+    builder.CreateRet(characterArgument);
+
+    llvm::verifyFunction(*outputFunction, &llvm::errs());
+}
+
+static void createStartFunction() {
+    startFunction = createFunction(llvm::Type::getVoidTy(context), {}, false, "\1_start");
+    startFunction->setDoesNotReturn();
+    startFunction->addFnAttr("stackrealign");
+
+    llvm::BasicBlock * entryBlock = llvm::BasicBlock::Create(context, "entry", startFunction);
+    builder.SetInsertPoint(entryBlock);
+
+    llvm::Value * returnValue = builder.CreateCall(mainFunction, {}, "returnValue");
+
+    builder.CreateCall(flushOutputFunction);
+
+    createSyscall(Syscall::exit, {builder.CreateZExt(returnValue, llvm::Type::getInt64Ty(context))});
 
-    passManager->run(*inputFunction);
+    builder.CreateUnreachable();
+
+    llvm::verifyFunction(*startFunction, &llvm::errs());
 }
 
 
-static llvm::Error generateIR(std::vector<Instruction>::iterator loopStart = instructions.end()) {
+static llvm::Value * getCurrentCellPointer() {
+    if (loopCells) return loopCellVariables[loopCellOffset];
+
+    llvm::Type * i8 = llvm::Type::getInt8Ty(context);
+    llvm::Type * i8Ptr = llvm::Type::getInt8PtrTy(context);
+    llvm::Type * i64 = llvm::Type::getInt64Ty(context);
+
+    llvm::Value * cells = builder.CreateLoad(i8Ptr, cellsVariable);
+    llvm::Value * currentCell = builder.CreateLoad(i64, currentCellVariable);
+
+    return builder.CreateGEP(i8, cells, currentCell);
+}
+
+static llvm::Error generatePartition(std::vector<Instruction>::iterator loopStart, std::vector<Instruction>::iterator end);
+static llvm::Error generateBoundsCheckedLoop(std::vector<Instruction>::iterator end);
+
+static llvm::Error generateIR(std::vector<Instruction>::iterator loopStart = instructions.end(),
+                              std::vector<Instruction>::iterator end = instructions.end()) {
     llvm::Type * i8 = llvm::Type::getInt8Ty(context);
     llvm::Type * i8Ptr = llvm::Type::getInt8PtrTy(context);
     llvm::Type * i64 = llvm::Type::getInt64Ty(context);
@@ -346,43 +783,57 @@ static llvm::Error generateIR(std::vector<Instruction>::iterator loopStart = ins
     llvm::BasicBlock * loopBlock = nullptr;
     llvm::BasicBlock * mergeBlock = nullptr;
 
-    while (currentInstruction != instructions.end()) {
+    while (currentInstruction != end) {
         switch (*currentInstruction) {
             case Instruction::moveRight: {
-                builder.CreateCall(moveRightFunction, {cellsAlloca, cellsLengthAlloca, currentCellAlloca});
+                if (loopCells) {
+                    ++loopCellOffset;
+                } else if (checkUpperBound) {
+                    builder.CreateCall(moveRightFunction, {cellsVariable, cellsLengthVariable, currentCellVariable});
+                } else {
+                    llvm::Value * currentCell = builder.CreateLoad(i64, currentCellVariable);
+
+                    currentCell = builder.CreateAdd(currentCell, builder.getInt64(1), "incrementedCurrentCell");
+
+                    builder.CreateStore(currentCell, currentCellVariable);
+                }
 
                 break;
             }
             case Instruction::moveLeft: {
-                llvm::Value * currentCell = builder.CreateLoad(i64, currentCellAlloca);
+                if (loopCells) {
+                    --loopCellOffset;
+                    break;
+                }
+
+                llvm::Value * currentCell = builder.CreateLoad(i64, currentCellVariable);
 
-                llvm::Value * returnWithError = builder.CreateICmpEQ(currentCell, builder.getInt64(0), "returnWithError");
+                if (checkLowerBound) {
+                    llvm::Value * returnWithError = builder.CreateICmpEQ(currentCell, builder.getInt64(0), "returnWithError");
 
-                llvm::BasicBlock * moveLeftBlock = llvm::BasicBlock::Create(context, "moveLeft", mainFunction);
+                    llvm::BasicBlock * moveLeftBlock = llvm::BasicBlock::Create(context, "moveLeft", currentFunction);
 
-                builder.CreateCondBr(returnWithError, errorBlock, moveLeftBlock);
+                    builder.CreateCondBr(returnWithError, errorBlock, moveLeftBlock);
 
-                builder.SetInsertPoint(moveLeftBlock);
+                    builder.SetInsertPoint(moveLeftBlock);
 
-                currentCell = builder.CreateLoad(i64, currentCellAlloca);
+                    currentCell = builder.CreateLoad(i64, currentCellVariable);
+                }
 
                 currentCell = builder.CreateSub(currentCell, builder.getInt64(1), "decrementedCurrentCell");
 
-                builder.CreateStore(currentCell, currentCellAlloca);
+                builder.CreateStore(currentCell, currentCellVariable);
 
                 break;
             }
             case Instruction::increment: {
                 uint8_t increment = 1;
-                while ((currentInstruction + 1) != instructions.end() && *(currentInstruction + 1) == Instruction::increment) {
+                while ((currentInstruction + 1) != end && *(currentInstruction + 1) == Instruction::increment) {
                     ++increment;
                     ++currentInstruction;
                 }
 
-                llvm::Value * cells = builder.CreateLoad(i8Ptr, cellsAlloca);
-                llvm::Value * currentCell = builder.CreateLoad(i64, currentCellAlloca);
-
-                llvm::Value * cellsGEP = builder.CreateGEP(i8, cells, currentCell);
+                llvm::Value * cellsGEP = getCurrentCellPointer();
 
                 llvm::Value * currentCellValue = builder.CreateLoad(i8, cellsGEP);
 
@@ -394,15 +845,12 @@ static llvm::Error generateIR(std::vector<Instruction>::iterator loopStart = ins
             }
             case Instruction::decrement: {
                 uint8_t decrement = 1;
-                while ((currentInstruction + 1) != instructions.end() && *(currentInstruction + 1) == Instruction::decrement) {
+                while ((currentInstruction + 1) != end && *(currentInstruction + 1) == Instruction::decrement) {
                     ++decrement;
                     ++currentInstruction;
                 }
 
-                llvm::Value * cells = builder.CreateLoad(i8Ptr, cellsAlloca);
-                llvm::Value * currentCell = builder.CreateLoad(i64, currentCellAlloca);
-
-                llvm::Value * cellsGEP = builder.CreateGEP(i8, cells, currentCell);
+                llvm::Value * cellsGEP = getCurrentCellPointer();
 
                 llvm::Value * currentCellValue = builder.CreateLoad(i8, cellsGEP);
 
@@ -413,29 +861,44 @@ static llvm::Error generateIR(std::vector<Instruction>::iterator loopStart = ins
                 break;
             }
             case Instruction::output: {
-                llvm::Value * cells = builder.CreateLoad(i8Ptr, cellsAlloca);
-                llvm::Value * currentCell = builder.CreateLoad(i64, currentCellAlloca);
-
-                llvm::Value * cellsGEP = builder.CreateGEP(i8, cells, currentCell);
+                llvm::Value * cellsGEP = getCurrentCellPointer();
 
                 llvm::Value * currentCellValue = builder.CreateLoad(i8, cellsGEP);
 
                 currentCellValue = builder.CreateZExt(currentCellValue, llvm::Type::getInt32Ty(context));
 
-                builder.CreateCall(putcharFunction, {currentCellValue});
+                builder.CreateCall(outputFunction, {currentCellValue});
 
                 break;
             }
             case Instruction::input: {
-                llvm::Value * cells = builder.CreateLoad(i8Ptr, cellsAlloca);
-                llvm::Value * currentCell = builder.CreateLoad(i64, currentCellAlloca);
-                builder.CreateCall(inputFunction, {cells, currentCell, currentLineAlloca, lengthAlloca, currentPositionAlloca});
+                llvm::Value * cells;
+                llvm::Value * currentCell;
+
+                if (loopCells) {
+                    cells = loopCells;
+                    currentCell = builder.getInt64(loopCellOffset);
+                } else {
+                    cells = builder.CreateLoad(i8Ptr, cellsVariable);
+                    currentCell = builder.CreateLoad(i64, currentCellVariable);
+                }
+
+                if (freestandingOption) {
+                    builder.CreateCall(inputFunction, {cells, currentCell});
+                } else {
+                    builder.CreateCall(inputFunction, {cells, currentCell, currentLineVariable, lengthVariable, currentPositionVariable});
+                }
+
+                if (loopCells) {
+                    llvm::Value * cellValue = builder.CreateLoad(i8, builder.CreateGEP(i8, cells, currentCell));
+                    builder.CreateStore(cellValue, loopCellVariables[loopCellOffset]);
+                }
 
                 break;
             }
             case Instruction::startLoop: {
                 if (loopStart == currentInstruction) {
-                    loopBlock = llvm::BasicBlock::Create(context, "loop", mainFunction);
+                    loopBlock = llvm::BasicBlock::Create(context, "loop", currentFunction);
                     llvm::BasicBlock * thenBlock = llvm::BasicBlock::Create(context, "then");
                     mergeBlock = llvm::BasicBlock::Create(context, "merge");
 
@@ -443,10 +906,7 @@ static llvm::Error generateIR(std::vector<Instruction>::iterator loopStart = ins
 
                     builder.SetInsertPoint(loopBlock);
 
-                    llvm::Value * cells = builder.CreateLoad(i8Ptr, cellsAlloca);
-                    llvm::Value * currentCell = builder.CreateLoad(i64, currentCellAlloca);
-
-                    llvm::Value * cellsGEP = builder.CreateGEP(i8, cells, currentCell);
+                    llvm::Value * cellsGEP = getCurrentCellPointer();
 
                     llvm::Value * currentCellValue = builder.CreateLoad(i8, cellsGEP);
 
@@ -456,10 +916,10 @@ static llvm::Error generateIR(std::vector<Instruction>::iterator loopStart = ins
 
                     loopBlock = builder.GetInsertBlock();
 
-                    mainFunction->getBasicBlockList().push_back(thenBlock);
+                    currentFunction->getBasicBlockList().push_back(thenBlock);
                     builder.SetInsertPoint(thenBlock);
                 } else {
-                    if (auto error = generateIR(currentInstruction)) return error;
+                    if (auto error = generateBoundsCheckedLoop(end)) return error;
                 }
 
                 break;
@@ -469,7 +929,7 @@ static llvm::Error generateIR(std::vector<Instruction>::iterator loopStart = ins
 
                 builder.CreateBr(loopBlock);
 
-                mainFunction->getBasicBlockList().push_back(mergeBlock);
+                currentFunction->getBasicBlockList().push_back(mergeBlock);
                 builder.SetInsertPoint(mergeBlock);
 
                 return llvm::Error::success();
@@ -483,6 +943,520 @@ static llvm::Error generateIR(std::vector<Instruction>::iterator loopStart = ins
 }
 
 
+// Returns the number of instructions that are generated into the function for the given range, which excludes
+// nested loops that are outlined into their own partitions.
+static size_t computeFunctionLength(size_t start, size_t end) {
+    size_t length = 0;
+
+    for (size_t i = start; i < end; ++i) {
+        if (i > start && instructions[i] == Instruction::startLoop && partitionSizeOption && loopLengths[i] > partitionSizeOption) {
+            i += loopLengths[i] - 1;
+            continue;
+        }
+
+        ++length;
+    }
+
+    return length;
+}
+
+static llvm::Error generatePartition(std::vector<Instruction>::iterator loopStart, std::vector<Instruction>::iterator end) {
+    llvm::Type * i32 = llvm::Type::getInt32Ty(context);
+
+    std::vector<llvm::Value *> stateVariables = {cellsVariable, cellsLengthVariable, currentCellVariable};
+    if (!freestandingOption) {
+        stateVariables.insert(stateVariables.end(), {currentLineVariable, lengthVariable, currentPositionVariable});
+    }
+
+    std::vector<llvm::Type *> params;
+    for (llvm::Value * stateVariable : stateVariables)
+        params.push_back(stateVariable->getType());
+
+    llvm::Function * partitionFunction = createFunction(i32, params, false, "partition", llvm::GlobalValue::InternalLinkage);
+
+    size_t partitionStart = currentInstruction - instructions.begin();
+    size_t partitionEnd = loopStart == instructions.end() ? end - instructions.begin() : partitionStart + loopLengths[partitionStart];
+    if (computeFunctionLength(partitionStart, partitionEnd) > loopOptimizationLengthLimit) {
+        partitionFunction->addFnAttr(llvm::Attribute::OptimizeForSize);
+    }
+
+    llvm::Value * status = builder.CreateCall(partitionFunction, stateVariables, "status");
+
+    llvm::Value * returnWithError = builder.CreateICmpNE(status, builder.getInt32(0), "returnWithError");
+
+    llvm::BasicBlock * continueBlock = llvm::BasicBlock::Create(context, "continue", currentFunction);
+
+    builder.CreateCondBr(returnWithError, errorBlock, continueBlock);
+
+    llvm::Function * outerFunction = currentFunction;
+    llvm::BasicBlock * outerErrorBlock = errorBlock;
+
+    currentFunction = partitionFunction;
+    errorBlock = llvm::BasicBlock::Create(context, "error");
+
+    // The state variables are distinct allocas of main, so they never alias each other.
+    const char * argumentNames[] = {"cells", "cellsLength", "currentCell", "currentLine", "length", "currentPosition"};
+    std::vector<llvm::Value *> arguments;
+    for (llvm::Argument & argument : partitionFunction->args()) {
+        argument.setName(argumentNames[argument.getArgNo()]);
+        argument.addAttr(llvm::Attribute::NoAlias);
+        arguments.push_back(&argument);
+    }
+
+    cellsVariable = arguments[0];
+    cellsLengthVariable = arguments[1];
+    currentCellVariable = arguments[2];
+    if (!freestandingOption) {
+        currentLineVariable = arguments[3];
+        lengthVariable = arguments[4];
+        currentPositionVariable = arguments[5];
+    }
+
+    llvm::BasicBlock * entryBlock = llvm::BasicBlock::Create(context, "entry", partitionFunction);
+    builder.SetInsertPoint(entryBlock);
+
+    if (auto error = generateIR(loopStart, end)) return error;
+
+    builder.CreateRet(builder.getInt32(0));
+
+    partitionFunction->getBasicBlockList().push_back(errorBlock);
+    builder.SetInsertPoint(errorBlock);
+
+    builder.CreateRet(builder.getInt32(1));
+
+    llvm::verifyFunction(*partitionFunction, &llvm::errs());
+
+    currentFunction = outerFunction;
+    errorBlock = outerErrorBlock;
+
+    cellsVariable = stateVariables[0];
+    cellsLengthVariable = stateVariables[1];
+    currentCellVariable = stateVariables[2];
+    if (!freestandingOption) {
+        currentLineVariable = stateVariables[3];
+        lengthVariable = stateVariables[4];
+        currentPositionVariable = stateVariables[5];
+    }
+
+    builder.SetInsertPoint(continueBlock);
+
+    return llvm::Error::success();
+}
+
+static llvm::Error generateBalancedLoop(std::vector<Instruction>::iterator end) {
+    llvm::Type * i8 = llvm::Type::getInt8Ty(context);
+    llvm::Type * i8Ptr = llvm::Type::getInt8PtrTy(context);
+    llvm::Type * i64 = llvm::Type::getInt64Ty(context);
+
+    size_t loopStart = currentInstruction - instructions.begin();
+    size_t loopEnd = loopStart + loopLengths[loopStart];
+
+    llvm::Value * cells = builder.CreateLoad(i8Ptr, cellsVariable);
+    llvm::Value * currentCell = builder.CreateLoad(i64, currentCellVariable);
+
+    loopCells = builder.CreateGEP(i8, cells, currentCell, "loopCells");
+    loopCellOffset = 0;
+
+    // Every cell the loop touches gets its own variable in the entry block, which mem2reg turns into
+    // SSA values. The cells are loaded once before the loop and written back once after it.
+    llvm::BasicBlock & entryBlock = currentFunction->getEntryBlock();
+    llvm::IRBuilder<> entryBuilder(&entryBlock, entryBlock.begin());
+
+    int64_t offset = 0;
+    for (size_t i = loopStart; i < loopEnd; ++i) {
+        switch (instructions[i]) {
+            case Instruction::moveRight: ++offset; break;
+            case Instruction::moveLeft: --offset; break;
+            default: {
+                if (loopCellVariables.count(offset)) break;
+
+                llvm::AllocaInst * cellVariable = entryBuilder.CreateAlloca(i8, nullptr, "cell");
+
+                llvm::Value * cellValue = builder.CreateLoad(i8, builder.CreateGEP(i8, loopCells, builder.getInt64(offset)));
+                builder.CreateStore(cellValue, cellVariable);
+
+                loopCellVariables[offset] = cellVariable;
+
+                break;
+            }
+        }
+    }
+
+    if (auto error = generateIR(currentInstruction, end)) return error;
+
+    for (const auto & cellVariable : loopCellVariables) {
+        llvm::Value * cellValue = builder.CreateLoad(i8, cellVariable.second);
+        builder.CreateStore(cellValue, builder.CreateGEP(i8, loopCells, builder.getInt64(cellVariable.first)));
+    }
+
+    loopCells = nullptr;
+    loopCellVariables.clear();
+
+    return llvm::Error::success();
+}
+
+static llvm::Error generateLoop(std::vector<Instruction>::iterator end) {
+    size_t loopStart = currentInstruction - instructions.begin();
+
+    if (partitionSizeOption && loopLengths[loopStart] > partitionSizeOption) {
+        return generatePartition(currentInstruction, end);
+    }
+
+    // Loops that always return to the cell they started at and don't need any bounds checks can
+    // address their cells with constant offsets, so they are kept in registers.
+    if (!loopCells && !checkLowerBound && !checkUpperBound && loopRanges[loopStart].hasStaticOffsets && !currentFunction->hasOptSize()) {
+        return generateBalancedLoop(end);
+    }
+
+    return generateIR(currentInstruction, end);
+}
+
+static llvm::Error generateBoundsCheckedLoop(std::vector<Instruction>::iterator end) {
+    llvm::Type * i64 = llvm::Type::getInt64Ty(context);
+
+    size_t loopStart = currentInstruction - instructions.begin();
+    const TapeRange & range = loopRanges[loopStart];
+    if (!range.isBounded || (!checkLowerBound && !checkUpperBound)) return generateLoop(end);
+
+    bool outerCheckLowerBound = checkLowerBound;
+    bool outerCheckUpperBound = checkUpperBound;
+
+    // The loop never leaves the cells between its minimum and maximum offset, so the tape
+    // only has to be grown once before it is entered.
+    if (checkUpperBound && range.maximumOffset > 0) {
+        llvm::Value * currentCell = builder.CreateLoad(i64, currentCellVariable);
+        llvm::Value * requiredLength = builder.CreateAdd(currentCell, builder.getInt64(range.maximumOffset + 1), "requiredLength");
+
+        builder.CreateCall(reserveCellsFunction, {cellsVariable, cellsLengthVariable, requiredLength});
+    }
+
+    checkUpperBound = false;
+
+    // Loops that are moved into their own partition are not versioned, because both copies would
+    // generate a separate function for the whole loop body.
+    bool isPartitioned = partitionSizeOption && loopLengths[loopStart] > partitionSizeOption;
+
+    if (checkLowerBound && range.minimumOffset < 0 && canVersionLoops && !isPartitioned) {
+        // If the loop might move below the first cell, it is generated twice: once without any checks
+        // and once with a check for every move to the left, so that the error is still reported exactly
+        // where it happens.
+        llvm::Value * currentCell = builder.CreateLoad(i64, currentCellVariable);
+        llvm::Value * mayUnderflow = builder.CreateICmpULT(currentCell, builder.getInt64(-range.minimumOffset), "mayUnderflow");
+
+        llvm::BasicBlock * checkedBlock = llvm::BasicBlock::Create(context, "checked", currentFunction);
+        llvm::BasicBlock * uncheckedBlock = llvm::BasicBlock::Create(context, "unchecked", currentFunction);
+        llvm::BasicBlock * mergeBlock = llvm::BasicBlock::Create(context, "merge");
+
+        builder.CreateCondBr(mayUnderflow, checkedBlock, uncheckedBlock);
+
+        auto loopBegin = currentInstruction;
+
+        builder.SetInsertPoint(uncheckedBlock);
+        checkLowerBound = false;
+
+        if (auto error = generateLoop(end)) return error;
+
+        builder.CreateBr(mergeBlock);
+
+        currentInstruction = loopBegin;
+
+        builder.SetInsertPoint(checkedBlock);
+        checkLowerBound = true;
+        canVersionLoops = false;
+
+        if (auto error = generateLoop(end)) return error;
+
+        canVersionLoops = true;
+
+        builder.CreateBr(mergeBlock);
+        currentFunction->getBasicBlockList().push_back(mergeBlock);
+        builder.SetInsertPoint(mergeBlock);
+    } else {
+        if (range.minimumOffset >= 0) checkLowerBound = false;
+
+        if (auto error = generateLoop(end)) return error;
+    }
+
+    checkLowerBound = outerCheckLowerBound;
+    checkUpperBound = outerCheckUpperBound;
+
+    return llvm::Error::success();
+}
+
+static llvm::Error generatePartitionedIR() {
+    while (currentInstruction != instructions.end()) {
+        // Chunks only end on the top level, so that every loop is generated into a single chunk.
+        auto chunkEnd = currentInstruction;
+        size_t depth = 0;
+        size_t chunkSize = 0;
+
+        while (chunkEnd != instructions.end() && (depth > 0 || chunkSize < partitionSizeOption)) {
+            if (*chunkEnd == Instruction::startLoop) {
+                ++depth;
+            } else if (*chunkEnd == Instruction::endLoop) {
+                if (depth == 0) {
+                    chunkEnd = instructions.end();
+                    break;
+                }
+
+                --depth;
+            }
+
+            ++chunkEnd;
+            ++chunkSize;
+        }
+
+        if (auto error = generatePartition(instructions.end(), chunkEnd)) return error;
+    }
+
+    return llvm::Error::success();
+}
+
+static void computeLoopLengths() {
+    loopLengths.assign(instructions.size(), 0);
+
+    std::vector<size_t> loopStarts;
+    for (size_t i = 0; i < instructions.size(); ++i) {
+        if (instructions[i] == Instruction::startLoop) {
+            loopStarts.push_back(i);
+        } else if (instructions[i] == Instruction::endLoop && !loopStarts.empty()) {
+            loopLengths[loopStarts.back()] = i - loopStarts.back() + 1;
+            loopStarts.pop_back();
+        }
+    }
+}
+
+
+static std::unique_ptr<llvm::TargetMachine> createTargetMachine(const llvm::Target * target, llvm::StringRef targetTriple) {
+    llvm::TargetOptions options;
+    auto relocationModel = llvm::Optional<llvm::Reloc::Model>();
+    return std::unique_ptr<llvm::TargetMachine>(target->createTargetMachine(targetTriple, "generic", "", options, relocationModel));
+}
+
+static void optimizeModule(llvm::Module & module, llvm::TargetMachine & targetMachine) {
+    llvm::legacy::FunctionPassManager passManager(&module);
+    passManager.add(llvm::createTargetTransformInfoWrapperPass(targetMachine.getTargetIRAnalysis()));
+    passManager.add(llvm::createPromoteMemoryToRegisterPass());
+    passManager.add(llvm::createInstructionCombiningPass());
+    passManager.add(llvm::createReassociatePass());
+    passManager.add(llvm::createGVNPass());
+    passManager.add(llvm::createCFGSimplificationPass());
+    passManager.add(llvm::createLoopRotatePass());
+    passManager.add(llvm::createLICMPass());
+    passManager.add(llvm::createIndVarSimplifyPass());
+    passManager.add(llvm::createLoopVectorizePass());
+    passManager.add(llvm::createLoopUnrollPass());
+    passManager.add(llvm::createInstructionCombiningPass());
+    passManager.add(llvm::createCFGSimplificationPass());
+
+    // Promoting the state variables of a large function to registers makes code generation superlinear,
+    // so functions that are optimized for size keep them on the stack.
+    llvm::legacy::FunctionPassManager sizePassManager(&module);
+    sizePassManager.add(llvm::createTargetTransformInfoWrapperPass(targetMachine.getTargetIRAnalysis()));
+    sizePassManager.add(llvm::createInstructionCombiningPass());
+    sizePassManager.add(llvm::createReassociatePass());
+    sizePassManager.add(llvm::createGVNPass());
+    sizePassManager.add(llvm::createCFGSimplificationPass());
+
+    passManager.doInitialization();
+    sizePassManager.doInitialization();
+
+    for (llvm::Function & function : module) {
+        if (function.isDeclaration()) continue;
+
+        if (function.hasOptSize()) {
+            sizePassManager.run(function);
+        } else {
+            passManager.run(function);
+        }
+    }
+
+    passManager.doFinalization();
+    sizePassManager.doFinalization();
+}
+
+static llvm::Error emitObjectFile(llvm::Module & module, llvm::TargetMachine & targetMachine, std::string & objectFilePath) {
+    int tempFileDescriptor;
+    llvm::SmallString<128> tempFilePath;
+    if (auto errorCode = llvm::sys::fs::createTemporaryFile(module.getName(), "o", tempFileDescriptor, tempFilePath)) {
+        return llvm::createStringError(errorCode, "Could not create temporary file: " + errorCode.message());
+    }
+
+    llvm::raw_fd_ostream outputFileStream(tempFileDescriptor, true);
+
+    llvm::legacy::PassManager outputPassManager;
+    auto outputFileType = llvm::CGFT_ObjectFile;
+
+    if (targetMachine.addPassesToEmitFile(outputPassManager, outputFileStream, nullptr, outputFileType)) {
+        return llvm::createStringError(llvm::inconvertibleErrorCode(), "Target machine cannot emit a file of this type");
+    }
+
+    outputPassManager.run(module);
+    outputFileStream.flush();
+
+    objectFilePath = std::string(tempFilePath);
+
+    return llvm::Error::success();
+}
+
+static llvm::Error compileModule(std::unique_ptr<llvm::Module> module, const llvm::Target * target, bool isPartitioned,
+                                 std::vector<std::string> & objectFilePaths) {
+    unsigned threadCount = threadCountOption ? threadCountOption : std::max(std::thread::hardware_concurrency(), 1u);
+
+    size_t functionCount = std::count_if(module->begin(), module->end(), [](const llvm::Function & function) {
+        return !function.isDeclaration();
+    });
+
+    // Splitting only pays off if the program was partitioned. Small programs just consist of main and the runtime functions.
+    if (!isPartitioned || threadCount == 1 || functionCount <= 1) {
+        auto targetMachine = createTargetMachine(target, module->getTargetTriple());
+
+        optimizeModule(*module, *targetMachine);
+
+        objectFilePaths.emplace_back();
+        return emitObjectFile(*module, *targetMachine, objectFilePaths.back());
+    }
+
+    // Every thread needs its own context, so the partitions are handed over as bitcode.
+    std::vector<llvm::SmallString<0>> partitions;
+    auto addPartition = [&](std::unique_ptr<llvm::Module> partition) {
+        partitions.emplace_back();
+        llvm::raw_svector_ostream partitionStream(partitions.back());
+        llvm::WriteBitcodeToFile(*partition, partitionStream);
+    };
+
+    unsigned partitionCount = std::min<size_t>(threadCount, functionCount);
+
+#if LLVM_VERSION_MAJOR >= 13
+    llvm::SplitModule(*module, partitionCount, addPartition, false);
+#else
+    llvm::SplitModule(std::move(module), partitionCount, addPartition, false);
+#endif
+
+    objectFilePaths.resize(partitions.size());
+    std::vector<std::string> errorMessages(partitions.size());
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < partitions.size(); ++i) {
+        threads.emplace_back([&, i]() {
+            llvm::LLVMContext partitionContext;
+
+            auto partition = llvm::parseBitcodeFile(llvm::MemoryBufferRef(partitions[i], "partition"), partitionContext);
+            if (!partition) {
+                errorMessages[i] = llvm::toString(partition.takeError());
+                return;
+            }
+
+            auto targetMachine = createTargetMachine(target, (*partition)->getTargetTriple());
+
+            optimizeModule(**partition, *targetMachine);
+
+            if (auto error = emitObjectFile(**partition, *targetMachine, objectFilePaths[i])) {
+                errorMessages[i] = llvm::toString(std::move(error));
+            }
+        });
+    }
+
+    for (std::thread & thread : threads)
+        thread.join();
+
+    for (const std::string & errorMessage : errorMessages) {
+        if (!errorMessage.empty()) return llvm::createStringError(llvm::inconvertibleErrorCode(), errorMessage);
+    }
+
+    return llvm::Error::success();
+}
+
+static TapeRange analyzeTapeRange(size_t begin, size_t end);
+
+static TapeRange analyzeLoopTapeRange(size_t loopStart) {
+    TapeRange range = {false, false, 0, 0, 0, 0};
+
+    size_t loopLength = loopLengths[loopStart];
+    if (loopLength == 0) return range;
+
+    size_t loopEnd = loopStart + loopLength - 1;
+    TapeRange bodyRange = analyzeTapeRange(loopStart + 1, loopEnd);
+
+    // A body that ends with [-] or [+] leaves a zero in the current cell, so it runs at most once.
+    bool runsAtMostOnce = loopLength >= 5
+        && instructions[loopEnd - 3] == Instruction::startLoop
+        && (instructions[loopEnd - 2] == Instruction::increment || instructions[loopEnd - 2] == Instruction::decrement)
+        && instructions[loopEnd - 1] == Instruction::endLoop;
+
+    if (bodyRange.isBounded && bodyRange.minimumMovement == 0 && bodyRange.maximumMovement == 0) {
+        range = bodyRange;
+    } else if (bodyRange.isBounded && runsAtMostOnce) {
+        range = bodyRange;
+        range.hasStaticOffsets = false;
+        range.minimumMovement = std::min<int64_t>(range.minimumMovement, 0);
+        range.maximumMovement = std::max<int64_t>(range.maximumMovement, 0);
+    }
+
+    loopRanges[loopStart] = range;
+
+    return range;
+}
+
+static TapeRange analyzeTapeRange(size_t begin, size_t end) {
+    TapeRange range = {true, true, 0, 0, 0, 0};
+
+    for (size_t i = begin; i < end; ++i) {
+        switch (instructions[i]) {
+            case Instruction::moveRight: {
+                ++range.minimumMovement;
+                ++range.maximumMovement;
+                range.maximumOffset = std::max(range.maximumOffset, range.maximumMovement);
+
+                break;
+            }
+            case Instruction::moveLeft: {
+                --range.minimumMovement;
+                --range.maximumMovement;
+                range.minimumOffset = std::min(range.minimumOffset, range.minimumMovement);
+
+                break;
+            }
+            case Instruction::startLoop: {
+                if (loopLengths[i] == 0) {
+                    range.isBounded = false;
+                    range.hasStaticOffsets = false;
+                    return range;
+                }
+
+                TapeRange loopRange = analyzeLoopTapeRange(i);
+
+                range.isBounded = range.isBounded && loopRange.isBounded;
+                range.hasStaticOffsets = range.hasStaticOffsets && loopRange.hasStaticOffsets;
+                range.minimumOffset = std::min(range.minimumOffset, range.minimumMovement + loopRange.minimumOffset);
+                range.maximumOffset = std::max(range.maximumOffset, range.maximumMovement + loopRange.maximumOffset);
+                range.minimumMovement += loopRange.minimumMovement;
+                range.maximumMovement += loopRange.maximumMovement;
+
+                i += loopLengths[i] - 1;
+
+                break;
+            }
+            case Instruction::endLoop: {
+                range.isBounded = false;
+                range.hasStaticOffsets = false;
+
+                break;
+            }
+            default: break;
+        }
+    }
+
+    return range;
+}
+
+static void computeTapeRanges() {
+    loopRanges.assign(instructions.size(), {false, false, 0, 0, 0, 0});
+
+    programRange = analyzeTapeRange(0, instructions.size());
+}
+
+
 llvm::Optional<std::string> getSDKPath() {
     llvm::SmallString<128> tempFilePath;
     if (auto error = llvm::sys::fs::createTemporaryFile("sdkpath", "", tempFilePath)) {
@@ -522,11 +1496,14 @@ llvm::Optional<std::string> getSDKPath() {
 }
 
 
-int link(llvm::StringRef tempFilePath, llvm::StringRef outputFilePath) {
-    auto sdkPath = getSDKPath();
-    if (!sdkPath) {
-        llvm::errs() << "Could not find path of MacOSK.sdk";
-        return 1;
+int link(const std::vector<std::string> & objectFilePaths, llvm::StringRef outputFilePath) {
+    llvm::Optional<std::string> sdkPath;
+    if (!freestandingOption) {
+        sdkPath = getSDKPath();
+        if (!sdkPath) {
+            llvm::errs() << "Could not find path of MacOSK.sdk";
+            return 1;
+        }
     }
 
 
@@ -536,15 +1513,16 @@ int link(llvm::StringRef tempFilePath, llvm::StringRef outputFilePath) {
         return 1;
     }
 
-    llvm::StringRef ldArgs[] = {
-        *ldPath,
-        "-syslibroot",
-        sdkPath.getValue(),
-        "-lSystem",
-        tempFilePath,
-        "-o",
-        outputFilePath
-    };
+    std::vector<llvm::StringRef> ldArgs = {*ldPath};
+
+    if (freestandingOption) {
+        ldArgs.insert(ldArgs.end(), {"-static", "-e", "_start"});
+    } else {
+        ldArgs.insert(ldArgs.end(), {"-syslibroot", sdkPath.getValue(), "-lSystem"});
+    }
+
+    ldArgs.insert(ldArgs.end(), objectFilePaths.begin(), objectFilePaths.end());
+    ldArgs.insert(ldArgs.end(), {"-o", outputFilePath});
 
     int ldReturn = llvm::sys::ExecuteAndWait(*ldPath, ldArgs);
     if (ldReturn) {
@@ -596,59 +1574,127 @@ int main(int argc, const char ** argv) {
 
     currentInstruction = instructions.begin();
 
-    module = std::make_unique<llvm::Module>(fileBaseName, context);
-    module->setSourceFileName(argv[1]);
+    computeLoopLengths();
+    computeTapeRanges();
 
-    passManager = std::make_unique<llvm::legacy::FunctionPassManager>(module.get());
-    passManager->add(llvm::createInstructionCombiningPass());
-    passManager->add(llvm::createReassociatePass());
-    passManager->add(llvm::createGVNPass());
-    passManager->add(llvm::createCFGSimplificationPass());
+    std::string targetTriple = llvm::sys::getDefaultTargetTriple();
 
-    passManager->doInitialization();
+    if (freestandingOption) {
+        syscallABI = getSyscallABI(llvm::Triple(targetTriple));
+        if (!syscallABI) {
+            llvm::errs() << "Freestanding executables are not supported for target " << targetTriple << "\n";
+            return 1;
+        }
+    }
+
+    module = std::make_unique<llvm::Module>(fileBaseName, context);
+    module->setSourceFileName(argv[1]);
+    module->setTargetTriple(targetTriple);
 
-    createSTDIO();
+    // If the pointer stays within a statically known range, the tape gets exactly that many cells.
+    bool hasFixedTape = programRange.isBounded;
+    uint64_t tapeLength = hasFixedTape ? programRange.maximumOffset + 1 : staticTapeLength;
 
-    mallocFunction = createFunction(llvm::Type::getInt8PtrTy(context), {llvm::Type::getInt64Ty(context)}, false, "malloc");
-    reallocFunction = createFunction(llvm::Type::getInt8PtrTy(context), {llvm::Type::getInt8PtrTy(context), llvm::Type::getInt64Ty(context)}, false, "realloc");
-    freeFunction = createFunction(llvm::Type::getVoidTy(context), {llvm::Type::getInt8PtrTy(context)}, false, "free");
-    strlenFunction = createFunction(llvm::Type::getInt64Ty(context), {llvm::Type::getInt8PtrTy(context)}, false, "strlen");
-    getlineFunction = createFunction(llvm::Type::getInt64Ty(context), {llvm::Type::getInt8PtrTy(context)->getPointerTo(), llvm::Type::getInt64PtrTy(context), fileStruct->getPointerTo()}, false, "getline");
-    fputsFunction = createFunction(llvm::Type::getInt32Ty(context), {llvm::Type::getInt8PtrTy(context), fileStruct->getPointerTo()}, false, "fputs");
-    putcharFunction = createFunction(llvm::Type::getInt32Ty(context), {llvm::Type::getInt32Ty(context)}, false, "putchar");
+    if (freestandingOption || hasFixedTape) {
+        llvm::ArrayType * tapeType = llvm::ArrayType::get(llvm::Type::getInt8Ty(context), tapeLength);
+        staticTape = new llvm::GlobalVariable(*module, tapeType, false, llvm::GlobalValue::InternalLinkage,
+                                              llvm::ConstantAggregateZero::get(tapeType), "tape");
+    }
 
-    createMoveRightFunction();
-    createInputFunction();
+    if (freestandingOption) {
+        llvm::ArrayType * outputBufferType = llvm::ArrayType::get(llvm::Type::getInt8Ty(context), outputBufferLength);
+        outputBuffer = new llvm::GlobalVariable(*module, outputBufferType, false, llvm::GlobalValue::InternalLinkage,
+                                                llvm::ConstantAggregateZero::get(outputBufferType), "outputBuffer");
+        outputBufferPosition = new llvm::GlobalVariable(*module, llvm::Type::getInt64Ty(context), false, llvm::GlobalValue::InternalLinkage,
+                                                        builder.getInt64(0), "outputBufferPosition");
+
+        llvm::ArrayType * inputBufferType = llvm::ArrayType::get(llvm::Type::getInt8Ty(context), inputBufferLength);
+        inputBuffer = new llvm::GlobalVariable(*module, inputBufferType, false, llvm::GlobalValue::InternalLinkage,
+                                               llvm::ConstantAggregateZero::get(inputBufferType), "inputBuffer");
+        inputBufferPosition = new llvm::GlobalVariable(*module, llvm::Type::getInt64Ty(context), false, llvm::GlobalValue::InternalLinkage,
+                                                       builder.getInt64(0), "inputBufferPosition");
+        inputBufferEnd = new llvm::GlobalVariable(*module, llvm::Type::getInt64Ty(context), false, llvm::GlobalValue::InternalLinkage,
+                                                  builder.getInt64(0), "inputBufferEnd");
+
+        createGrowCellsFunction();
+        createFlushOutputFunction();
+        createFreestandingOutputFunction();
+        createMoveRightFunction();
+        createReserveCellsFunction();
+        createFreestandingInputFunction();
+    } else {
+        createSTDIO();
+
+        mallocFunction = createFunction(llvm::Type::getInt8PtrTy(context), {llvm::Type::getInt64Ty(context)}, false, "malloc");
+        reallocFunction = createFunction(llvm::Type::getInt8PtrTy(context), {llvm::Type::getInt8PtrTy(context), llvm::Type::getInt64Ty(context)}, false, "realloc");
+        freeFunction = createFunction(llvm::Type::getVoidTy(context), {llvm::Type::getInt8PtrTy(context)}, false, "free");
+        strlenFunction = createFunction(llvm::Type::getInt64Ty(context), {llvm::Type::getInt8PtrTy(context)}, false, "strlen");
+        getlineFunction = createFunction(llvm::Type::getInt64Ty(context), {llvm::Type::getInt8PtrTy(context)->getPointerTo(), llvm::Type::getInt64PtrTy(context), fileStruct->getPointerTo()}, false, "getline");
+        fputsFunction = createFunction(llvm::Type::getInt32Ty(context), {llvm::Type::getInt8PtrTy(context), fileStruct->getPointerTo()}, false, "fputs");
+        putcharFunction = createFunction(llvm::Type::getInt32Ty(context), {llvm::Type::getInt32Ty(context)}, false, "putchar");
+
+        outputFunction = putcharFunction;
+
+        createMoveRightFunction();
+        createReserveCellsFunction();
+        createInputFunction();
+    }
 
-    mainFunction = createFunction(llvm::Type::getInt32Ty(context), {}, false, "main");
+    mainFunction = createFunction(llvm::Type::getInt32Ty(context), {}, false, "main",
+                                  freestandingOption ? llvm::GlobalValue::InternalLinkage : llvm::GlobalValue::ExternalLinkage);
     llvm::BasicBlock * mainEntryBlock = llvm::BasicBlock::Create(context, "entry", mainFunction);
     errorBlock = llvm::BasicBlock::Create(context, "error");
     llvm::BasicBlock * returnBlock = llvm::BasicBlock::Create(context, "return");
 
     builder.SetInsertPoint(mainEntryBlock);
 
-    emptyString = builder.CreateGlobalString("", "emptyString");
     moveLeftErrorString = builder.CreateGlobalString("Error: Cannot move pointer to negative cell!\n", "moveLeftErrorString");
 
-    cellsAlloca = builder.CreateAlloca(llvm::Type::getInt8PtrTy(context), nullptr, "cells");
-    cellsLengthAlloca = builder.CreateAlloca(llvm::Type::getInt64Ty(context), nullptr, "cellsLength");
-    currentCellAlloca = builder.CreateAlloca(llvm::Type::getInt64Ty(context), nullptr, "currentCell");
-    currentLineAlloca = builder.CreateAlloca(llvm::Type::getInt8PtrTy(context), nullptr, "currentLine");
-    lengthAlloca = builder.CreateAlloca(llvm::Type::getInt64Ty(context), nullptr, "length");
-    currentPositionAlloca = builder.CreateAlloca(llvm::Type::getInt8PtrTy(context), nullptr, "currentPosition");
+    cellsVariable = builder.CreateAlloca(llvm::Type::getInt8PtrTy(context), nullptr, "cells");
+    cellsLengthVariable = builder.CreateAlloca(llvm::Type::getInt64Ty(context), nullptr, "cellsLength");
+    currentCellVariable = builder.CreateAlloca(llvm::Type::getInt64Ty(context), nullptr, "currentCell");
+
+    llvm::Value * cells;
+
+    if (staticTape) {
+        cells = builder.CreateConstInBoundsGEP2_64(staticTape->getValueType(), staticTape, 0, 0, "cells");
+
+        builder.CreateStore(cells, cellsVariable);
+        builder.CreateStore(builder.getInt64(tapeLength), cellsLengthVariable);
+    } else {
+        cells = builder.CreateCall(mallocFunction, {builder.getInt64(4)});
 
-    llvm::Value * cells = builder.CreateCall(mallocFunction, {builder.getInt64(4)});
+        builder.CreateStore(cells, cellsVariable);
+        builder.CreateStore(builder.getInt64(4), cellsLengthVariable);
+    }
+
+    builder.CreateStore(builder.getInt64(0), currentCellVariable);
+
+    if (!freestandingOption) {
+        emptyString = builder.CreateGlobalString("", "emptyString");
+
+        currentLineVariable = builder.CreateAlloca(llvm::Type::getInt8PtrTy(context), nullptr, "currentLine");
+        lengthVariable = builder.CreateAlloca(llvm::Type::getInt64Ty(context), nullptr, "length");
+        currentPositionVariable = builder.CreateAlloca(llvm::Type::getInt8PtrTy(context), nullptr, "currentPosition");
+
+        builder.CreateStore(llvm::ConstantPointerNull::get(llvm::Type::getInt8PtrTy(context)), currentLineVariable);
+        builder.CreateStore(builder.getInt64(0), lengthVariable);
+
+        llvm::Value * castedEmptyString = builder.CreateBitCast(emptyString, llvm::Type::getInt8PtrTy(context), "emptyString");
+        builder.CreateStore(castedEmptyString, currentPositionVariable);
+    }
 
-    builder.CreateStore(cells, cellsAlloca);
-    builder.CreateStore(builder.getInt64(4), cellsLengthAlloca);
-    builder.CreateStore(builder.getInt64(0), currentCellAlloca);
-    builder.CreateStore(llvm::ConstantPointerNull::get(llvm::Type::getInt8PtrTy(context)), currentLineAlloca);
-    builder.CreateStore(builder.getInt64(0), lengthAlloca);
+    currentFunction = mainFunction;
 
-    llvm::Value * castedEmptyString = builder.CreateBitCast(emptyString, llvm::Type::getInt8PtrTy(context), "emptyString");
-    builder.CreateStore(castedEmptyString, currentPositionAlloca);
+    checkUpperBound = !hasFixedTape;
+    checkLowerBound = !hasFixedTape || programRange.minimumOffset < 0;
 
-    if (auto error = generateIR()) {
+    bool shouldPartition = partitionSizeOption && instructions.size() > partitionSizeOption;
+    if (!shouldPartition && instructions.size() > loopOptimizationLengthLimit) {
+        mainFunction->addFnAttr(llvm::Attribute::OptimizeForSize);
+    }
+
+    if (auto error = shouldPartition ? generatePartitionedIR() : generateIR()) {
         mainFunction->eraseFromParent();
 
         llvm::errs() << "Parsing Error: " << error << "\n";
@@ -664,8 +1710,14 @@ int main(int argc, const char ** argv) {
     builder.SetInsertPoint(errorBlock);
 
     llvm::Value * castedErrorString = builder.CreateBitCast(moveLeftErrorString, llvm::Type::getInt8PtrTy(context), "errorString");
-    llvm::Value * stderrV = builder.CreateLoad(fileStruct->getPointerTo(), stderrP);
-    builder.CreateCall(fputsFunction, {castedErrorString, stderrV});
+
+    if (freestandingOption) {
+        uint64_t errorStringLength = moveLeftErrorString->getValueType()->getArrayNumElements() - 1;
+        createSyscall(Syscall::write, {builder.getInt64(2), castedErrorString, builder.getInt64(errorStringLength)});
+    } else {
+        llvm::Value * stderrV = builder.CreateLoad(fileStruct->getPointerTo(), stderrP);
+        builder.CreateCall(fputsFunction, {castedErrorString, stderrV});
+    }
 
     builder.CreateBr(returnBlock);
 
@@ -678,17 +1730,21 @@ int main(int argc, const char ** argv) {
     phi->addIncoming(builder.getInt32(0), lastBlock);
     phi->addIncoming(builder.getInt32(1), errorBlock);
 
-    cells = builder.CreateLoad(llvm::Type::getInt8PtrTy(context), cellsAlloca);
-    builder.CreateCall(freeFunction, {cells});
+    if (!freestandingOption) {
+        if (!hasFixedTape) {
+            cells = builder.CreateLoad(llvm::Type::getInt8PtrTy(context), cellsVariable);
+            builder.CreateCall(freeFunction, {cells});
+        }
 
-    llvm::Value * currentLine = builder.CreateLoad(llvm::Type::getInt8PtrTy(context), currentLineAlloca);
-    builder.CreateCall(freeFunction, {currentLine});
+        llvm::Value * currentLine = builder.CreateLoad(llvm::Type::getInt8PtrTy(context), currentLineVariable);
+        builder.CreateCall(freeFunction, {currentLine});
+    }
 
     builder.CreateRet(phi);
 
     llvm::verifyFunction(*mainFunction, &llvm::errs());
 
-    passManager->run(*mainFunction);
+    if (freestandingOption) createStartFunction();
 
     llvm::verifyModule(*module, &llvm::errs());
 
@@ -699,9 +1755,6 @@ int main(int argc, const char ** argv) {
     llvm::InitializeAllAsmParsers();
     llvm::InitializeAllAsmPrinters();
 
-    std::string targetTriple = llvm::sys::getDefaultTargetTriple();
-    module->setTargetTriple(targetTriple);
-
     std::string errorString;
     const llvm::Target * target = llvm::TargetRegistry::lookupTarget(targetTriple, errorString);
 
@@ -710,35 +1763,22 @@ int main(int argc, const char ** argv) {
         return 1;
     }
 
-    llvm::TargetOptions options;
-    auto relocationModel = llvm::Optional<llvm::Reloc::Model>();
-    auto targetMachine = target->createTargetMachine(targetTriple, "generic", "", options, relocationModel);
+    module->setDataLayout(createTargetMachine(target, targetTriple)->createDataLayout());
 
-    module->setDataLayout(targetMachine->createDataLayout());
 
+    std::vector<std::string> objectFilePaths;
+    int returnValue;
 
-    int tempFileDescriptor;
-    llvm::SmallString<128> tempFilePath;
-    if (auto error = llvm::sys::fs::createTemporaryFile(fileBaseName, "o", tempFileDescriptor, tempFilePath)) {
-        llvm::errs() << "Could not create temporary file: " << error.message();
-        return 1;
+    if (auto error = compileModule(std::move(module), target, shouldPartition, objectFilePaths)) {
+        llvm::errs() << error;
+        returnValue = 1;
+    } else {
+        returnValue = link(objectFilePaths, outputFilePath);
     }
 
-    {
-        llvm::raw_fd_ostream outputFileStream(tempFileDescriptor, true);
-
-        llvm::legacy::PassManager outputPassManager;
-        auto outputFileType = llvm::CGFT_ObjectFile;
-
-        if (targetMachine->addPassesToEmitFile(outputPassManager, outputFileStream, nullptr, outputFileType)) {
-            llvm::errs() << "Target machine cannot emit a file of this type";
-            return 1;
-        }
-
-        outputPassManager.run(*module);
-        outputFileStream.flush();
+    for (const std::string & objectFilePath : objectFilePaths) {
+        if (!objectFilePath.empty()) llvm::sys::fs::remove(objectFilePath);
     }
 
-
-    return link(tempFilePath, outputFilePath);
+    return returnValue;
 }